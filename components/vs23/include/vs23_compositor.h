@@ -0,0 +1,52 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "vs23_sram.h"
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define VS23_COMPOSITOR_MAX_LAYERS 8
+
+/// A rectangle of 8 bpp pixels placed on the picture. Pixels come from RAM,
+/// or from a VS23 SRAM surface when pixels is NULL.
+typedef struct {
+    const uint8_t *pixels;
+    const vs23_surface_t *surface;
+    int16_t x;
+    int16_t y;
+    uint16_t width;
+    uint16_t height;
+    uint16_t stride;    // Bytes between RAM lines
+    uint8_t z;          // Higher is drawn on top
+    bool visible;
+    bool transparent;   // Pixels equal to key are not drawn
+    uint8_t key;
+} vs23_layer_t;
+
+/// Composites the picture from layers over a background color, 8 bpp only.
+/// The other calls do nothing until it succeeded. A picture changed by
+/// vs23_reconfigure is followed on the next present, all dirty; if the new
+/// picture cannot be composited the compositor stops until the next init.
+esp_err_t vs23_compositor_init(uint8_t background);
+void vs23_compositor_deinit();
+/// Returns the layer id, -1 when all slots are used or before init.
+int vs23_compositor_add_layer(const vs23_layer_t *layer);
+void vs23_compositor_remove_layer(int id);
+/// Replaces a layer (position, visibility, source), both its old and new
+/// extents are marked dirty. Unknown ids are ignored, as by remove_layer.
+void vs23_compositor_update_layer(int id, const vs23_layer_t *layer);
+/// Marks picture lines to composite again, after a layer content change.
+void vs23_compositor_mark_dirty(int16_t y, uint16_t height);
+/// Composites the dirty lines and sends each of them once, always picking
+/// the dirty line the beam passed last and never the line being scanned.
+void vs23_compositor_present();
+
+#ifdef __cplusplus
+}
+#endif
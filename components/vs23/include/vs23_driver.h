@@ -1,5 +1,7 @@
 #include "driver/spi_master.h"
 
+#include "vs23_sram.h"
+
 #pragma once
 
 #ifdef __cplusplus
@@ -22,6 +24,15 @@ extern "C" {
 #define VS23_VIDEO_CONTROL2_VIDEO_ENABLED      (1<<15)
 #define VS23_VIDEO_CONTROL2_PAL_MODE           (1<<14)
 
+/// Block move control 1, low byte
+#define VS23_BLOCK_MOVE_BACKWARDS              (1<<0)
+#define VS23_BLOCK_MOVE_TARGET_ODD             (1<<1)
+#define VS23_BLOCK_MOVE_SOURCE_ODD             (1<<2)
+#define VS23_BLOCK_MOVE_PAL_Y_LOWPASS          (1<<4)
+
+#define VS23_CURRENT_LINE_MASK                 0x03ff
+#define VS23_CURRENT_LINE_BLOCK_MOVE_DONE      (1<<15)
+
 #define XTAL_MHZ 4.43361875
 /// PLL frequency
 #define PLL_MHZ (XTAL_MHZ * 8.0)
@@ -63,10 +74,31 @@ extern "C" {
 #define LINE_HALF_LENGTH ((uint16_t)((LINE_LENGTH_US * XTAL_MHZ)/2+0.5-10.0/8.0))
 
 #define TOTAL_LINES 312
+/// Protolines 0..3 are the picture and PAL sync lines, the others are free
+/// backgrounds for picture lines. The index entry selects one of 16 at most.
+/// User protolines are opt-in: defining PROTOLINES above 4 switches to the
+/// 512 word hardware stride, 1024 bytes of SRAM per protoline in place of
+/// 568. With 8 protolines the picture starts 5920 bytes higher, which a
+/// full height 8 bpp picture no longer leaves room for.
+#ifndef PROTOLINES
 #define PROTOLINES 4
+#endif
+#if PROTOLINES > 16
+#error "The picture line index addresses 16 protolines at most"
+#endif
+#define FIRST_USER_PROTOLINE 4
 #define PROTOLINE_LENGTH_WORDS ((uint16_t)(LINE_LENGTH_US * XTAL_MHZ + 0.5))
-#define PROTOLINE_WORD_ADDRESS(n) (PROTOLINE_LENGTH_WORDS * n)
-#define PROTO_AREA_WORDS (PROTOLINE_LENGTH_WORDS * PROTOLINES)
+/// The proto field of a picture line index entry selects the protoline at
+/// word address proto * 512 (VS23S010 datasheet, picture line index; the
+/// VLSI reference code lays protolines out the same way). The compact
+/// layout only works while every picture line uses protoline 0.
+#if PROTOLINES > FIRST_USER_PROTOLINE
+#define PROTOLINE_STRIDE_WORDS 512
+#else
+#define PROTOLINE_STRIDE_WORDS PROTOLINE_LENGTH_WORDS
+#endif
+#define PROTOLINE_WORD_ADDRESS(n) (PROTOLINE_STRIDE_WORDS * (n))
+#define PROTO_AREA_WORDS (PROTOLINE_STRIDE_WORDS * PROTOLINES)
 #define INDEX_START_LONGWORDS ((PROTO_AREA_WORDS + 1) / 2)
 #define INDEX_START_WORDS (INDEX_START_LONGWORDS * 2)
 #define INDEX_START_BYTES (INDEX_START_WORDS * 2)
@@ -74,6 +106,9 @@ extern "C" {
 /// Picture area memory start point
 #define PICLINE_START (INDEX_START_BYTES + TOTAL_LINES * 3 + 1)
 
+/// Protoline level word, V in bits 15:12, U in bits 11:8, Y in bits 7:0
+#define PROTO_LEVEL(y, u, v) ((((v) << 12) & 0xf000) | (((u) << 8) & 0x0f00) | ((y) & 0x00ff))
+
 /// Sync is always 0
 #define SYNC_LEVEL  0x0000
 
@@ -102,6 +137,31 @@ extern "C" {
 #define PICK_BITS(a)(((a)-1)<<3)
 #define SHIFT_BITS(a)(a)
 
+/// Pixel formats, pixels are packed from the high bits of each byte.
+/// With VS23_VIDEO_CONTROL1_UV_FROM_TABLE the picked a/b bits index the
+/// u/v tables, which makes the pixel value a palette index.
+/// 8 bpp: v2 u2 y4
+#define PROGRAM_8BPP { \
+    .op_1 = PICK_B + PICK_BITS(2) + SHIFT_BITS(2), \
+    .op_2 = PICK_A + PICK_BITS(2) + SHIFT_BITS(2), \
+    .op_3 = PICK_Y + PICK_BITS(4) + SHIFT_BITS(4), \
+    .op_4 = PICK_NOTHING, \
+}
+/// 4 bpp: v1 u1 y2, 16 colors, a/b select table entries 0 and 2
+#define PROGRAM_4BPP { \
+    .op_1 = PICK_B + PICK_BITS(1) + SHIFT_BITS(3), \
+    .op_2 = PICK_A + PICK_BITS(1) + SHIFT_BITS(3), \
+    .op_3 = PICK_Y + PICK_BITS(2) + SHIFT_BITS(6), \
+    .op_4 = PICK_NOTHING, \
+}
+/// 2 bpp: y2, 4 levels tinted by u/v table entry 0
+#define PROGRAM_2BPP { \
+    .op_1 = PICK_Y + PICK_BITS(2) + SHIFT_BITS(6), \
+    .op_2 = PICK_NOTHING, \
+    .op_3 = PICK_NOTHING, \
+    .op_4 = PICK_NOTHING, \
+}
+
 void vs23_init_spi(spi_host_device_t host_id, const spi_bus_config_t *bus_config, spi_dma_chan_t dma_chan, int spics_io_num, int clock_speed_hz);
 
 void vs23_enter_sram_mode(); //, uint8_t read_command, uint8_t write_command ?
@@ -131,8 +191,64 @@ typedef struct {
 } video_config_t;
 
 void vs23_progressive_pal(video_config_t *video_config);
+/// Applies the differences between two configurations without rebuilding
+/// the protolines, registers are written during the vertical blank so that
+/// register only changes take effect between two frames. A picture size
+/// change also rewrites up to 900 index bytes after the registers, longer
+/// than the blank at low SPI clocks, so one frame may show the new picture
+/// area with part of the old line index.
+/// Fails with ESP_ERR_INVALID_STATE when a larger picture overlaps SRAM
+/// allocations, the old configuration stays active then.
+esp_err_t vs23_reconfigure(const video_config_t *old_config, const video_config_t *new_config);
+
+/// Builds a picture protoline: sync, color burst and level from blank end
+/// to the front porch. Visible around the picture area of the lines using it.
+/// Protolines 1 to 3 are the sync lines and are refused, as is anything
+/// from PROTOLINES on (ESP_ERR_INVALID_ARG).
+esp_err_t vs23_protoline_init(uint8_t protoline, uint16_t level);
+/// Sets length PLL clocks of a protoline to level, start counts from blank end.
+esp_err_t vs23_protoline_fill(uint8_t protoline, uint16_t start, uint16_t length, uint16_t level);
+/// Selects the protoline of count picture lines starting at picture line y.
+esp_err_t vs23_set_lines_protoline(uint16_t y, uint16_t count, uint8_t protoline);
 
+/// Describes the visible picture as a surface, for copies to and from it.
+void vs23_picture_surface(vs23_surface_t *surface);
+/// Picture line the beam is scanning, negative above the picture and
+/// height or more below it.
+int16_t vs23_beam_line();
+/// Copies lines of length bytes, stride bytes apart on both sides, inside
+/// the VS23 SRAM. Returns once the move is started.
+void vs23_block_move(uint32_t source, uint32_t target, uint16_t length, uint16_t lines, uint16_t stride);
+void vs23_block_move_wait();
+
+/// bits_per_pixel is 8, 4 or 2. Packed modes keep a RAM copy of the
+/// picture so that pixel and span writes do not read back over SPI.
+/// Packed pictures must only be written through set_pix_yuv,
+/// vs23_fill_span and the rasterizer. Block moves, surface copies and
+/// writes to the picture, scheduled writes, display list replays and
+/// plain write_buffer bypass the copy: call vs23_sync_shadow() after them.
 void set_pix_yuv(uint16_t x, uint16_t y, uint8_t yuv);
+/// Reloads the RAM copy of a packed picture from the SRAM.
+void vs23_sync_shadow();
+/// Sets length pixels of picture line y from x in a single burst.
+void vs23_fill_span(uint16_t x, uint16_t y, uint16_t length, uint8_t yuv);
+/// Largest buffer used when reading the picture back, a read is further
+/// limited to the SPI max transfer size so it needs no split.
+#define VS23_READ_CHUNK_BYTES 4096
+
+typedef void (*vs23_line_callback_t)(uint16_t y, const uint8_t *line, size_t length, void *context);
+
+/// Reads a picture rectangle back line by line, each line holds the bytes
+/// covering the pixels x to x + width - 1. ESP_ERR_NO_MEM when the read
+/// buffer cannot be allocated.
+esp_err_t vs23_read_rect_stream(uint16_t x, uint16_t y, uint16_t width, uint16_t height, vs23_line_callback_t callback, void *context);
+/// Reads a picture rectangle into buffer, lines packed. Full width
+/// rectangles are read in one transfer, buffer must then be DMA capable.
+esp_err_t vs23_read_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t *buffer);
+/// CRC32 (little endian, as esp_rom_crc32_le) of the bytes of a picture
+/// rectangle, 0 when the rectangle could not be read.
+uint32_t vs23_crc32_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height);
+
 uint8_t rgb_to_yuv(uint8_t r, uint8_t g, uint8_t b);
 
 #ifdef __cplusplus
@@ -0,0 +1,38 @@
+#include <stdint.h>
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Spans kept before sorting, merging and sending them to the picture
+#define VS23_RASTER_MAX_SPANS 256
+/// Edge crossings on one scanline of a filled polygon
+#define VS23_RASTER_MAX_CROSSINGS 32
+
+typedef struct {
+    int16_t x;
+    int16_t y;
+} vs23_point_t;
+
+/// Restricts drawing to a rectangle of the picture, reset to the whole
+/// picture with vs23_raster_reset_clip().
+void vs23_raster_set_clip(int16_t x, int16_t y, uint16_t width, uint16_t height);
+void vs23_raster_reset_clip();
+
+// Shapes are turned into horizontal spans, the spans of one scanline are
+// merged and each run is written as one burst.
+void vs23_draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t yuv);
+void vs23_draw_circle(int16_t cx, int16_t cy, uint16_t radius, uint8_t yuv);
+void vs23_fill_circle(int16_t cx, int16_t cy, uint16_t radius, uint8_t yuv);
+void vs23_fill_rect(int16_t x, int16_t y, uint16_t width, uint16_t height, uint8_t yuv);
+void vs23_fill_triangle(vs23_point_t a, vs23_point_t b, vs23_point_t c, uint8_t yuv);
+void vs23_draw_polygon(const vs23_point_t *points, uint16_t count, uint8_t yuv);
+/// Even-odd filled polygon, convex or concave. Scanlines crossing more than
+/// VS23_RASTER_MAX_CROSSINGS edges are left unfilled.
+void vs23_fill_polygon(const vs23_point_t *points, uint16_t count, uint8_t yuv);
+
+#ifdef __cplusplus
+}
+#endif
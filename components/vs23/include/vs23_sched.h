@@ -0,0 +1,57 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#include "vs23_driver.h"
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Pending writes per priority class
+#define VS23_SCHED_QUEUE_DEPTH 16
+/// Bulk writes are sent in slices of this size
+#define VS23_SCHED_SLICE_BYTES 1024
+/// Part of the frame time the bus may spend on scheduled writes
+#define VS23_SCHED_BUS_SHARE_PERCENT 50
+/// One PAL frame
+#define VS23_FRAME_US (TOTAL_LINES * LINE_LENGTH_US)
+
+typedef enum {
+    VS23_PRIORITY_INTERACTIVE, // Cursor, counters: always sent in the next frame
+    VS23_PRIORITY_NORMAL,
+    VS23_PRIORITY_BULK,        // Images: sliced, uses what is left of the budget
+    VS23_PRIORITY_COUNT
+} vs23_priority_t;
+
+typedef void (*vs23_sched_done_t)(void *context);
+
+typedef struct {
+    uint32_t completed;
+    uint32_t bytes;
+    uint16_t pending;
+    uint32_t average_latency_us; // From vs23_sched_write to the last byte sent
+    uint32_t max_latency_us;
+} vs23_sched_stats_t;
+
+/// Derives the per frame byte budget from the SPI clock and the line timing.
+/// vs23_sched_write may be called from any task, vs23_sched_run_frame from
+/// a single one.
+void vs23_sched_init(int clock_speed_hz);
+/// Recomputes the budget after an SPI clock change, queued writes are kept.
+void vs23_sched_set_clock(int clock_speed_hz);
+uint32_t vs23_sched_frame_budget();
+/// Queues length bytes for address. data must stay valid until done is
+/// called (done may be NULL).
+esp_err_t vs23_sched_write(vs23_priority_t priority, uint32_t address, const void *data, size_t length, vs23_sched_done_t done, void *context);
+/// Sends one frame worth of writes, highest priority first. Call once per frame.
+void vs23_sched_run_frame();
+void vs23_sched_get_stats(vs23_priority_t priority, vs23_sched_stats_t *stats);
+void vs23_sched_reset_stats();
+
+#ifdef __cplusplus
+}
+#endif
@@ -1,3 +1,4 @@
+#include <stdbool.h>
 #include <stdlib.h>
 
 #pragma once
@@ -8,6 +9,21 @@ extern "C" {
 
 // #define SPI_TESTS
 
+/// Transactions up to this size (in bits) are busy waited with
+/// spi_device_polling_transmit, larger ones use the interrupt driven path.
+/// The per size latencies of both paths are logged by spi_latency_benchmark().
+#define VS23_SPI_POLLING_MAX_BITS (32 * 8)
+
+/// Largest single transaction, matches the ESP-IDF default bus max_transfer_sz.
+/// Longer write_buffer/read_buffer calls are split into chunks of this size.
+#define VS23_SPI_DEFAULT_MAX_TRANSFER_BYTES 4092
+/// Number of chunks kept queued in the SPI driver during a split transfer.
+#define VS23_SPI_QUEUE_SIZE 4
+
+/// Size of the write combining buffer, a write that does not fit sends the
+/// pending burst first.
+#define VS23_WRITE_COMBINING_BYTES 128
+
 #define VS23_STATUS_SPI_HOLD_DISABLED    (1<<0) // Hold functionality functionality in Single and Dual mode SPI operations.
 #define VS23_STATUS_USER1                (1<<1) // User assignable bit.
 #define VS23_STATUS_USER2                (1<<2) // User assignable bit.
@@ -19,6 +35,13 @@ extern "C" {
 
 void add_spi_device(spi_host_device_t host_id, int clock_speed_hz, int spics_io_num);
 void remove_spi_device();
+// Sets the chunk size of split transfers, 0 selects the default.
+void set_max_transfer_size(size_t bytes);
+// Bytes sent or read in one transaction, a multiple of 4.
+size_t get_max_transfer_size();
+// Keeps the bus locked for this device across a batch of transactions, nestable.
+void acquire_spi_bus();
+void release_spi_bus();
 
 uint8_t read_status_register();
 void write_status_register(uint8_t status);
@@ -37,6 +60,42 @@ uint8_t make_cycle(uint8_t pick, uint8_t amount, uint8_t shift);
 void write_program(uint8_t cycle_1, uint8_t cycle_2, uint8_t cycle_3, uint8_t cycle_4);
 uint16_t read_current_line_pll_lock();
 void write_block_move_control1(uint16_t source, uint16_t target, uint8_t flags);
+void write_block_move_control2(uint16_t skip, uint16_t length, uint8_t lines);
+void start_block_move();
+
+// When enabled, write_byte/word/long at consecutive addresses are merged into
+// one burst, and a write to a byte already pending replaces it in place. The
+// burst is sent on an address gap, when the buffer is full, on any other
+// transaction or on flush_writes(). Returns the previous state.
+bool set_write_combining(bool enabled);
+void flush_writes();
+
+/// SRAM writes and register programs captured while drawing, packed as
+/// ready to queue transactions.
+typedef struct {
+    spi_transaction_ext_t *transactions;
+    uint16_t count;
+    uint16_t capacity;
+    uint8_t *data;
+    size_t data_length;
+    size_t data_capacity;
+    int64_t record_us;   // Time between begin and end
+    int64_t overhead_us; // Part of it spent capturing transactions
+    int64_t direct_us;   // The rest: drawing the screen directly
+    int64_t replay_us; // Time of the last replay
+    bool failed;       // Out of memory while recording, the list is empty
+} display_list_t;
+
+// Between begin and end every write and register program is executed and
+// appended to the list. Reads are executed only, so block move waits are
+// not replayed: keep block moves out of display lists.
+void begin_display_list(display_list_t *list);
+void end_display_list();
+/// Queues the recorded transactions back to back and logs the replay time
+/// next to the direct drawing time. A failed or still recording list is
+/// refused with ESP_ERR_INVALID_STATE.
+esp_err_t replay_display_list(display_list_t *list);
+void free_display_list(display_list_t *list);
 
 void write_buffer(uint32_t address, void *data, size_t length);
 void read_buffer(uint32_t address, void *data, size_t length);
@@ -47,6 +106,10 @@ uint16_t read_word(uint32_t address);
 void write_byte(uint32_t address, uint8_t data);
 uint8_t read_byte(uint32_t address);
 
+#ifdef SPI_TESTS
+void spi_latency_benchmark(uint32_t address);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,52 @@
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// VS23S010 SRAM size
+#define VS23_SRAM_BYTES (128 * 1024)
+/// Maximum number of reserved and allocated regions
+#define VS23_SRAM_MAX_REGIONS 32
+/// Surfaces start on a long word boundary
+#define VS23_SURFACE_ALIGN 4
+
+/// Offscreen rectangle of pixels in VS23 SRAM.
+/// Lines are stride bytes apart, pixels are packed as the picture.
+typedef struct {
+    uint32_t address;
+    uint16_t width;
+    uint16_t height;
+    uint16_t stride;
+    uint8_t bits_per_pixel;
+} vs23_surface_t;
+
+/// Forgets every region, the whole SRAM becomes free.
+void vs23_sram_reset();
+/// Marks a fixed range as used (protolines, index table, picture).
+esp_err_t vs23_sram_reserve(uint32_t address, uint32_t size);
+/// First fit allocation, address is aligned on align bytes (power of 2).
+esp_err_t vs23_sram_alloc(uint32_t size, uint32_t align, uint32_t *address);
+/// Releases an allocated or reserved region starting at address.
+void vs23_sram_free(uint32_t address);
+uint32_t vs23_sram_free_bytes();
+uint32_t vs23_sram_largest_free_block();
+
+/// Allocates an offscreen surface, stride 0 packs the lines.
+esp_err_t vs23_surface_alloc(vs23_surface_t *surface, uint16_t width, uint16_t height, uint8_t bits_per_pixel, uint16_t stride);
+void vs23_surface_free(vs23_surface_t *surface);
+/// Byte address of the pixel x, y
+uint32_t vs23_surface_address(const vs23_surface_t *surface, uint16_t x, uint16_t y);
+/// Uploads width x height pixels, data lines are packed.
+void vs23_surface_write(const vs23_surface_t *surface, uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t *data);
+/// Copies a rectangle between surfaces with SRAM to SRAM block moves.
+/// Source and target rectangles must not overlap.
+void vs23_surface_copy(const vs23_surface_t *source, uint16_t source_x, uint16_t source_y, const vs23_surface_t *target, uint16_t target_x, uint16_t target_y, uint16_t width, uint16_t height);
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,36 @@
+#include <stdint.h>
+
+#include "esp_err.h"
+
+#pragma once
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+    uint32_t bytes_saved; // Pixel bytes not sent over SPI thanks to hits
+} vs23_tile_cache_stats_t;
+
+/// Reserves up to slots tiles of tile_width x tile_height v2u2y4 pixels in
+/// free VS23 SRAM. The atlas lines use the picture stride so that a cached
+/// tile is drawn with a single block move. 8 bpp pictures only.
+esp_err_t vs23_tile_cache_init(uint16_t tile_width, uint16_t tile_height, uint16_t slots);
+void vs23_tile_cache_deinit();
+/// Draws width x height packed pixels at x, y. Tiles are keyed by a CRC32
+/// of their content and size plus a running byte sum; a cached tile is
+/// copied inside the SRAM, otherwise it is uploaded to the least recently
+/// used slot first. Pixels are not compared, two tiles matching on both
+/// keys would still draw the cached one. While vs23_reconfigure has left a
+/// picture of another stride, tiles are written directly; nothing is drawn
+/// on a packed picture.
+void vs23_draw_tile(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t *pixels);
+void vs23_tile_cache_get_stats(vs23_tile_cache_stats_t *stats);
+void vs23_tile_cache_reset_stats();
+
+#ifdef __cplusplus
+}
+#endif
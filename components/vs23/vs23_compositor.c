@@ -0,0 +1,189 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/spi_master.h"
+#include "esp_heap_caps.h"
+#include "esp_log.h"
+
+#include "vs23_spi.h"
+#include "vs23_driver.h"
+#include "vs23_compositor.h"
+
+static vs23_layer_t layers[VS23_COMPOSITOR_MAX_LAYERS];
+static bool used[VS23_COMPOSITOR_MAX_LAYERS];
+static vs23_surface_t picture;
+static uint8_t background_yuv;
+static uint32_t *dirty = NULL;
+// DMA capable composited line and SRAM layer fetch line
+static uint8_t *line = NULL;
+static uint8_t *fetch = NULL;
+
+// Sizes the buffers for the current picture and marks it all dirty
+esp_err_t _set_geometry() {
+    vs23_surface_t current;
+    vs23_picture_surface(&current);
+    if (current.bits_per_pixel != 8) return ESP_ERR_NOT_SUPPORTED;
+    uint32_t *new_dirty = calloc((current.height + 31) / 32, sizeof(uint32_t));
+    uint8_t *new_line = heap_caps_malloc(current.stride, MALLOC_CAP_DMA);
+    uint8_t *new_fetch = heap_caps_malloc((current.width + 3) & ~3, MALLOC_CAP_DMA);
+    if (new_dirty == NULL || new_line == NULL || new_fetch == NULL) {
+        free(new_dirty);
+        heap_caps_free(new_line);
+        heap_caps_free(new_fetch);
+        return ESP_ERR_NO_MEM;
+    }
+    vs23_compositor_deinit();
+    dirty = new_dirty;
+    line = new_line;
+    fetch = new_fetch;
+    picture = current;
+    vs23_compositor_mark_dirty(0, picture.height);
+    return ESP_OK;
+}
+
+bool _geometry_changed() {
+    vs23_surface_t current;
+    vs23_picture_surface(&current);
+    return current.address != picture.address || current.width != picture.width ||
+        current.height != picture.height || current.stride != picture.stride ||
+        current.bits_per_pixel != picture.bits_per_pixel;
+}
+
+esp_err_t vs23_compositor_init(uint8_t background) {
+    vs23_compositor_deinit();
+    background_yuv = background;
+    memset(used, 0, sizeof(used));
+    return _set_geometry();
+}
+
+void vs23_compositor_deinit() {
+    free(dirty);
+    heap_caps_free(line);
+    heap_caps_free(fetch);
+    dirty = NULL;
+    line = NULL;
+    fetch = NULL;
+}
+
+void vs23_compositor_mark_dirty(int16_t y, uint16_t height) {
+    if (dirty == NULL) return;
+    int32_t end = y + height;
+    if (y < 0) y = 0;
+    if (end > picture.height) end = picture.height;
+    for (int32_t i = y; i < end; i++) dirty[i / 32] |= 1u << (i % 32);
+}
+
+void _mark_layer(const vs23_layer_t *layer) {
+    vs23_compositor_mark_dirty(layer->y, layer->height);
+}
+
+int vs23_compositor_add_layer(const vs23_layer_t *layer) {
+    if (dirty == NULL) return -1;
+    for (int i = 0; i < VS23_COMPOSITOR_MAX_LAYERS; i++) {
+        if (used[i]) continue;
+        used[i] = true;
+        layers[i] = *layer;
+        _mark_layer(layer);
+        return i;
+    }
+    return -1;
+}
+
+bool _is_layer(int id) {
+    return id >= 0 && id < VS23_COMPOSITOR_MAX_LAYERS && used[id];
+}
+
+void vs23_compositor_remove_layer(int id) {
+    if (!_is_layer(id)) return;
+    used[id] = false;
+    _mark_layer(&layers[id]);
+}
+
+void vs23_compositor_update_layer(int id, const vs23_layer_t *layer) {
+    if (!_is_layer(id)) return;
+    _mark_layer(&layers[id]);
+    layers[id] = *layer;
+    _mark_layer(layer);
+}
+
+void _composite_line(int16_t y, const uint8_t *order, uint8_t count) {
+    memset(line, background_yuv, picture.width);
+    for (uint8_t n = 0; n < count; n++) {
+        const vs23_layer_t *layer = &layers[order[n]];
+        int16_t row = y - layer->y;
+        if (!layer->visible || row < 0 || row >= layer->height) continue;
+        int16_t from = layer->x < 0 ? -layer->x : 0;
+        int16_t to = layer->x + layer->width > picture.width ? picture.width - layer->x : layer->width;
+        if (from >= to) continue;
+        uint16_t length = to - from;
+        const uint8_t *source;
+        if (layer->pixels) {
+            source = layer->pixels + (uint32_t)layer->stride * row + from;
+        } else {
+            // SRAM layers are fetched at full read speed, covered parts included
+            read_buffer(vs23_surface_address(layer->surface, from, row), fetch, ((length + 3) & ~3) * 8);
+            source = fetch;
+        }
+        uint8_t *target = line + layer->x + from;
+        if (!layer->transparent) {
+            memcpy(target, source, length);
+            continue;
+        }
+        for (uint16_t x = 0; x < length; x++) {
+            if (source[x] != layer->key) target[x] = source[x];
+        }
+    }
+}
+
+void vs23_compositor_present() {
+    if (dirty == NULL) return;
+    // After vs23_reconfigure lines have another length and address
+    if (_geometry_changed()) {
+        esp_err_t err = _set_geometry();
+        if (err != ESP_OK) {
+            ESP_LOGW("VS23_COMPOSITOR", "Stopped, cannot follow the new picture: %s", esp_err_to_name(err));
+            vs23_compositor_deinit();
+            return;
+        }
+    }
+    // Layer ids in z order, bottom first
+    uint8_t order[VS23_COMPOSITOR_MAX_LAYERS];
+    uint8_t count = 0;
+    for (uint8_t i = 0; i < VS23_COMPOSITOR_MAX_LAYERS; i++) {
+        if (!used[i]) continue;
+        uint8_t j = count++;
+        while (j > 0 && layers[order[j - 1]].z > layers[i].z) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = i;
+    }
+
+    acquire_spi_bus();
+    while (1) {
+        // The beam moves on while lines are sent, so look at it again for
+        // each line. The line it has just left is not scanned again for a
+        // whole frame, search backwards from there. The line being scanned
+        // is left for later, writing it would show half old and half new.
+        int16_t beam = vs23_beam_line();
+        bool scanning = beam >= 0 && beam < picture.height;
+        uint16_t start = scanning ? beam + picture.height - 1 : picture.height - 1;
+        int32_t y = -1;
+        bool pending = false;
+        for (uint16_t n = 0; n < picture.height; n++) {
+            uint16_t candidate = (start - n) % picture.height;
+            if (!(dirty[candidate / 32] & (1u << (candidate % 32)))) continue;
+            pending = true;
+            if (scanning && candidate == beam) continue;
+            y = candidate;
+            break;
+        }
+        if (!pending) break;
+        // Only the line under the beam is left, wait for the beam to pass
+        if (y < 0) continue;
+        dirty[y / 32] &= ~(1u << (y % 32));
+        _composite_line(y, order, count);
+        write_buffer(vs23_surface_address(&picture, 0, y), line, picture.width * 8);
+    }
+    release_spi_bus();
+}
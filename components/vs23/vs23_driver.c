@@ -1,11 +1,18 @@
+#include <string.h>
+
 #include "freertos/FreeRTOS.h"
 #include "freertos/task.h"
 #include "driver/spi_master.h"
+#include "soc/soc_caps.h"
 
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_rom_crc.h"
+#include "esp_timer.h"
 
 #include "vs23_spi.h"
 #include "vs23_driver.h"
+#include "vs23_sched.h"
 
 spi_host_device_t _host_id;
 int _clock_speed_hz;
@@ -25,26 +32,35 @@ void vs23_init_spi(
     ESP_ERROR_CHECK(spi_bus_initialize(_host_id, bus_config, dma_chan));
 
     add_spi_device(_host_id, _clock_speed_hz, _spics_io_num);
+    // Without DMA the driver sends from its own buffer, whatever the bus
+    // configuration asks for
+    set_max_transfer_size(dma_chan == SPI_DMA_DISABLED ? SOC_SPI_MAXIMUM_BUFFER_SIZE : bus_config->max_transfer_sz);
+    vs23_sched_init(_clock_speed_hz);
 
+    // Bursts only fill consecutive addresses in sequential mode, set it
+    // before the combined writes clearing the SRAM
+    write_status_register(VS23_STATUS_SPI_MODE_SEQUENTIAL);
+    bool combining = set_write_combining(true);
     for (uint32_t i = 0; i < 0xefff; i++) {
         write_long(i, 0);
         if(i % 0xfff == 0) {
             vTaskDelay(1);
         }
     }
-
-    write_status_register(VS23_STATUS_SPI_MODE_SEQUENTIAL);
+    set_write_combining(combining);
 }
 
 void vs23_enter_sram_mode() {
     remove_spi_device();
     add_spi_device(_host_id, _clock_speed_hz, _spics_io_num);
+    vs23_sched_set_clock(_clock_speed_hz);
     write_status_register(VS23_STATUS_SPI_MODE_SEQUENTIAL);
 }
 
 void vs23_enter_fast_write_mode() {
     remove_spi_device();
     add_spi_device(_host_id, 4 * _clock_speed_hz, _spics_io_num);
+    vs23_sched_set_clock(4 * _clock_speed_hz);
 }
 
 void _set_line_index(uint16_t line, uint16_t wordAddress) {
@@ -54,8 +70,11 @@ void _set_line_index(uint16_t line, uint16_t wordAddress) {
     write_byte(indexAddr  , wordAddress >> 8);
 }
 
+// Protoline of each frame line showing a picture line
+static uint8_t line_protolines[TOTAL_LINES];
+
 void _set_pic_index(uint16_t line, uint32_t byteAddress) {
-    uint16_t protoAddress = 0;
+    uint16_t protoAddress = line_protolines[line];
     uint32_t indexAddr = INDEX_START_BYTES + line * 3;
     write_byte(indexAddr++, (uint16_t)((byteAddress << 7) & 0x80) | (protoAddress & 0xf)); // Byteaddress LSB, bits to 0, proto to given value
     write_byte(indexAddr++, (uint16_t)(byteAddress >> 1)); //This is wordaddress
@@ -64,10 +83,18 @@ void _set_pic_index(uint16_t line, uint32_t byteAddress) {
 
 static uint32_t picline_length_bytes;
 static uint32_t picture_start;
+static uint16_t picture_start_line;
+static uint16_t picture_width;
+static uint16_t picture_height;
+static uint8_t picture_bits_per_pixel;
+static uint8_t block_move_flags = VS23_BLOCK_MOVE_PAL_Y_LOWPASS;
+// DMA capable scratch line for span writes
+static uint8_t *line_buffer = NULL;
+static uint32_t line_buffer_bytes = 0;
+// RAM copy of a packed picture, so pixel writes never read back over SPI
+static uint8_t *shadow = NULL;
 
-void vs23_progressive_pal(video_config_t *video_config) {
-    write_ops_register(video_config->ops_register);
-
+void _write_picture_area(const video_config_t *video_config) {
     uint16_t picture_length = video_config->pllclks_per_pixel * video_config->width / 8;
     // The first pixel of the picture area, the X direction.
     uint16_t start_picture = BLANK_END + (LINE_LENGTH - BLANK_END - picture_length) / 2;
@@ -76,7 +103,9 @@ void vs23_progressive_pal(video_config_t *video_config) {
 
     write_picture_start(start_picture - 1);
     write_picture_end(end_picture - 1);
+}
 
+void _write_uv_tables(const video_config_t *video_config) {
     write_u_table(
         video_config->uv_tables.u[0],
         video_config->uv_tables.u[1],
@@ -89,22 +118,113 @@ void vs23_progressive_pal(video_config_t *video_config) {
         video_config->uv_tables.v[2],
         video_config->uv_tables.v[3]
     );
-    write_video_control1(video_config->flags, 0);
+}
 
-    write_line_length(LINE_LENGTH_PLL);
+void _write_pattern_program(const video_config_t *video_config) {
     write_program(
         video_config->program.op_1,
         video_config->program.op_2,
         video_config->program.op_3,
         video_config->program.op_4
     );
+}
+
+void _write_video_control2(const video_config_t *video_config) {
+    write_video_control2(VS23_VIDEO_CONTROL2_VIDEO_ENABLED | VS23_VIDEO_CONTROL2_PAL_MODE, video_config->pllclks_per_pixel - 1, TOTAL_LINES - 1);
+}
+
+uint16_t _start_line(const video_config_t *video_config) {
+    return 22 + (288 - video_config->height) / 2;
+}
+
+uint32_t _picline_length_bytes(const video_config_t *video_config) {
+    // Packed modes round up to keep the last pixels of the line
+    return (video_config->width * video_config->bits_per_pixel + 7) / 8;
+}
+
+/// SRAM byte address of the picture data shown on the given frame line,
+/// 0 when the line is not a picture line of this configuration.
+uint32_t _picline_address(const video_config_t *video_config, uint16_t line) {
+    if (video_config == NULL) return 0;
+    uint16_t start_line = _start_line(video_config);
+    if (line < start_line || line >= start_line + video_config->height) return 0;
+    uint16_t BEXTRA = 0;
+    // Picture lines are packed right after the index, the rest of the SRAM
+    // stays in one piece for the allocator.
+    return PICLINE_START + (_picline_length_bytes(video_config) + BEXTRA) * (line - start_line);
+}
+
+/// Points the index entries whose picture line moved from the old to the
+/// new configuration, an old configuration of NULL rewrites every entry.
+void _update_pic_indexes(const video_config_t *old_config, const video_config_t *new_config) {
+    for (uint16_t i = 5; i < 309; i++) {
+        uint32_t old_address = _picline_address(old_config, i);
+        uint32_t new_address = _picline_address(new_config, i);
+        if (old_config != NULL && old_address == new_address) continue;
+        if (new_address) {
+            _set_pic_index(i, new_address);
+        } else {
+            // Back to the blank protoline, a later picture must not inherit
+            // the protoline chosen for this line
+            line_protolines[i] = 0;
+            _set_line_index(i, PROTOLINE_WORD_ADDRESS(0));
+        }
+    }
+}
+
+void _set_picture(const video_config_t *video_config) {
+    picture_start = PICLINE_START;
+    picture_start_line = _start_line(video_config);
+    picline_length_bytes = _picline_length_bytes(video_config);
+    picture_width = video_config->width;
+    picture_height = video_config->height;
+    picture_bits_per_pixel = video_config->bits_per_pixel;
+    uint8_t *buffer = heap_caps_realloc(line_buffer, picline_length_bytes, MALLOC_CAP_DMA);
+    if (buffer != NULL) {
+        line_buffer = buffer;
+        line_buffer_bytes = picline_length_bytes;
+    } else {
+        // The old line stays usable for the spans it can hold
+        ESP_LOGW("DRIVER", "No RAM for the span line buffer");
+    }
+    heap_caps_free(shadow);
+    shadow = NULL;
+    if (picture_bits_per_pixel < 8) {
+        shadow = heap_caps_malloc((picline_length_bytes * picture_height + 3) & ~3, MALLOC_CAP_DMA);
+        if (shadow == NULL) ESP_LOGW("DRIVER", "No RAM for the picture shadow, packed writes read back");
+        // Start from what the SRAM holds, neighbour pixels are kept
+        vs23_sync_shadow();
+    }
+}
+
+/// Waits for the beam to leave the picture so that register changes
+/// apply between two frames.
+void _wait_for_vertical_blank(const video_config_t *video_config) {
+    uint16_t end_line = _start_line(video_config) + video_config->height;
+    int64_t deadline = esp_timer_get_time() + 2 * TOTAL_LINES * LINE_LENGTH_US;
+    while ((read_current_line_pll_lock() & VS23_CURRENT_LINE_MASK) < end_line) {
+        if (esp_timer_get_time() > deadline) return;
+    }
+}
+
+void vs23_progressive_pal(video_config_t *video_config) {
+    acquire_spi_bus();
+    bool combining = set_write_combining(true);
+    write_ops_register(video_config->ops_register);
+
+    _write_picture_area(video_config);
+    _write_uv_tables(video_config);
+    write_video_control1(video_config->flags, 0);
+
+    write_line_length(LINE_LENGTH_PLL);
+    _write_pattern_program(video_config);
 
     write_picture_index_start_address(INDEX_START_LONGWORDS);
 
     // Enable the PAL Y lowpass filter
     // loss in sharpness, less aberrations
-    write_block_move_control1(0, 0, 1<<4);
-    write_video_control2(VS23_VIDEO_CONTROL2_VIDEO_ENABLED | VS23_VIDEO_CONTROL2_PAL_MODE, video_config->pllclks_per_pixel - 1, TOTAL_LINES - 1);
+    write_block_move_control1(0, 0, block_move_flags);
+    _write_video_control2(video_config);
 
     // Construct protoline 0, used for picture lines
     uint16_t w = PROTOLINE_WORD_ADDRESS(0);
@@ -158,6 +278,10 @@ void vs23_progressive_pal(video_config_t *video_config) {
     w = PROTOLINE_WORD_ADDRESS(3) + LINE_HALF_LENGTH;
     for (uint16_t i = 0; i < SHORT_SYNC_M; i++) write_word(w++, SYNC_LEVEL); // Long sync at the middle of line
 
+    // The remaining protolines start as plain picture lines
+    for (uint8_t p = FIRST_USER_PROTOLINE; p < PROTOLINES; p++) ESP_ERROR_CHECK(vs23_protoline_init(p, BLANK_LEVEL));
+    memset(line_protolines, 0, sizeof(line_protolines));
+
     // Now set first eight lines of frame to point to PAL sync lines
     // Here the frame starts, lines 1 and 2
     _set_line_index(0, PROTOLINE_WORD_ADDRESS(2));
@@ -165,29 +289,268 @@ void vs23_progressive_pal(video_config_t *video_config) {
     _set_line_index(2, PROTOLINE_WORD_ADDRESS(3));
     _set_line_index(3, PROTOLINE_WORD_ADDRESS(1));
     _set_line_index(4, PROTOLINE_WORD_ADDRESS(1));
-    for (uint16_t i = 5; i < 309; i++) {
-        _set_line_index(i, PROTOLINE_WORD_ADDRESS(0));
-    }
     _set_line_index(309, PROTOLINE_WORD_ADDRESS(1));
     _set_line_index(310, PROTOLINE_WORD_ADDRESS(1));
     _set_line_index(311, PROTOLINE_WORD_ADDRESS(1));
 
-    // Set pic line indexes to point to protoline 0 and their individual picture line.
-    uint16_t start_line = 22 + (288 - video_config->height) / 2;
-    uint16_t end_line = start_line + video_config->height;
-    picline_length_bytes = video_config->width * video_config->bits_per_pixel / 8 + 0.5;// + 1;
-    uint16_t BEXTRA = 0;
-    picture_start = PICLINE_START + (picline_length_bytes + BEXTRA) * start_line;
+    // Set pic line indexes to point to protoline 0 and their individual picture line,
+    // the other lines between 5 and 308 to the blank protoline 0.
+    _update_pic_indexes(NULL, video_config);
+    _set_picture(video_config);
+
+    vs23_sram_reset();
+    ESP_ERROR_CHECK(vs23_sram_reserve(0, PICLINE_START));
+    ESP_ERROR_CHECK(vs23_sram_reserve(picture_start, picline_length_bytes * picture_height));
+    set_write_combining(combining);
+    release_spi_bus();
+}
+
+esp_err_t vs23_reconfigure(const video_config_t *old_config, const video_config_t *new_config) {
+    bool picture_changed =
+        old_config->width != new_config->width ||
+        old_config->height != new_config->height ||
+        old_config->bits_per_pixel != new_config->bits_per_pixel;
+
+    // Claim the new picture size first, allocations may be in the way
+    if (picture_changed) {
+        vs23_sram_free(picture_start);
+        esp_err_t err = vs23_sram_reserve(PICLINE_START, _picline_length_bytes(new_config) * new_config->height);
+        if (err != ESP_OK) {
+            ESP_ERROR_CHECK(vs23_sram_reserve(picture_start, picline_length_bytes * picture_height));
+            return err;
+        }
+    }
 
-    for (uint16_t i = start_line; i < end_line; i++) {
-        uint32_t picline_byte_address = PICLINE_START + (picline_length_bytes + BEXTRA) * i;
-        _set_pic_index(i, picline_byte_address);
+    acquire_spi_bus();
+    bool combining = set_write_combining(true);
+    _wait_for_vertical_blank(old_config);
+
+    if (old_config->ops_register != new_config->ops_register) {
+        write_ops_register(new_config->ops_register);
+    }
+    if (old_config->width != new_config->width || old_config->pllclks_per_pixel != new_config->pllclks_per_pixel) {
+        _write_picture_area(new_config);
+    }
+    if (memcmp(&old_config->uv_tables, &new_config->uv_tables, sizeof(struct uv_tables_t))) {
+        _write_uv_tables(new_config);
+    }
+    if (old_config->flags != new_config->flags) {
+        write_video_control1(new_config->flags, 0);
+    }
+    if (memcmp(&old_config->program, &new_config->program, sizeof(struct program_t))) {
+        _write_pattern_program(new_config);
+    }
+    if (old_config->pllclks_per_pixel != new_config->pllclks_per_pixel) {
+        _write_video_control2(new_config);
+    }
+    // Protolines do not depend on the configuration, only the index moves.
+    // This runs past the blank at low SPI clocks, see vs23_driver.h.
+    if (picture_changed) {
+        _update_pic_indexes(old_config, new_config);
+        _set_picture(new_config);
     }
+
+    set_write_combining(combining);
+    release_spi_bus();
+    return ESP_OK;
+}
+
+bool _is_picture_protoline(uint8_t protoline) {
+    return protoline == 0 || (protoline >= FIRST_USER_PROTOLINE && protoline < PROTOLINES);
+}
+
+esp_err_t vs23_protoline_init(uint8_t protoline, uint16_t level) {
+    if (!_is_picture_protoline(protoline)) return ESP_ERR_INVALID_ARG;
+    uint16_t *words = heap_caps_malloc(PROTOLINE_LENGTH_WORDS * 2, MALLOC_CAP_DMA);
+    if (words == NULL) return ESP_ERR_NO_MEM;
+    for (uint16_t i = 0; i < PROTOLINE_LENGTH_WORDS; i++) {
+        uint16_t word = BLANK_LEVEL;
+        if (i < SYNC) word = SYNC_LEVEL;
+        else if (i >= BURST && i < BURST + BURST_DURATION) word = BURST_LEVEL;
+        else if (i >= BLANK_END && i < FRONT_PORCH) word = level;
+        words[i] = SPI_SWAP_DATA_TX(word, 16);
+    }
+    write_buffer(PROTOLINE_WORD_ADDRESS(protoline) * 2, words, PROTOLINE_LENGTH_WORDS * 16);
+    heap_caps_free(words);
+    return ESP_OK;
+}
+
+esp_err_t vs23_protoline_fill(uint8_t protoline, uint16_t start, uint16_t length, uint16_t level) {
+    if (!_is_picture_protoline(protoline)) return ESP_ERR_INVALID_ARG;
+    bool combining = set_write_combining(true);
+    uint16_t w = PROTOLINE_WORD_ADDRESS(protoline) + BLANK_END + start;
+    for (uint16_t i = 0; i < length && w < PROTOLINE_WORD_ADDRESS(protoline) + FRONT_PORCH; i++) write_word(w++, level);
+    set_write_combining(combining);
+    return ESP_OK;
+}
+
+esp_err_t vs23_set_lines_protoline(uint16_t y, uint16_t count, uint8_t protoline) {
+    if (!_is_picture_protoline(protoline)) return ESP_ERR_INVALID_ARG;
+    bool combining = set_write_combining(true);
+    for (uint16_t i = y; i < y + count && i < picture_height; i++) {
+        uint16_t line = picture_start_line + i;
+        uint32_t picline_byte_address = picture_start + picline_length_bytes * i;
+        line_protolines[line] = protoline;
+        // Only the first byte of the entry holds the protoline
+        write_byte(INDEX_START_BYTES + line * 3, (uint16_t)((picline_byte_address << 7) & 0x80) | line_protolines[line]);
+    }
+    set_write_combining(combining);
+    return ESP_OK;
+}
+
+void vs23_picture_surface(vs23_surface_t *surface) {
+    surface->address = picture_start;
+    surface->width = picture_width;
+    surface->height = picture_height;
+    surface->stride = picline_length_bytes;
+    surface->bits_per_pixel = picture_bits_per_pixel;
+}
+
+int16_t vs23_beam_line() {
+    return (int16_t)(read_current_line_pll_lock() & VS23_CURRENT_LINE_MASK) - picture_start_line;
+}
+
+void vs23_block_move_wait() {
+    int64_t deadline = esp_timer_get_time() + 100000;
+    while (!(read_current_line_pll_lock() & VS23_CURRENT_LINE_BLOCK_MOVE_DONE)) {
+        if (esp_timer_get_time() > deadline) {
+            ESP_LOGW("DRIVER", "Block move timeout");
+            return;
+        }
+    }
+}
+
+void vs23_block_move(uint32_t source, uint32_t target, uint16_t length, uint16_t lines, uint16_t stride) {
+    while (lines > 0) {
+        // The line count register is 8 bits wide
+        uint16_t batch = lines > 256 ? 256 : lines;
+        uint8_t flags = block_move_flags;
+        if (source & 1) flags |= VS23_BLOCK_MOVE_SOURCE_ODD;
+        if (target & 1) flags |= VS23_BLOCK_MOVE_TARGET_ODD;
+        vs23_block_move_wait();
+        write_block_move_control1(source >> 1, target >> 1, flags);
+        write_block_move_control2(stride - length, length, batch - 1);
+        start_block_move();
+        source += (uint32_t)stride * batch;
+        target += (uint32_t)stride * batch;
+        lines -= batch;
+    }
+}
+
+void vs23_sync_shadow() {
+    if (shadow == NULL) return;
+    read_buffer(picture_start, shadow, ((picline_length_bytes * picture_height + 3) & ~3) * 8);
+}
+
+/// Picture byte at offset from the picture start
+uint8_t _picture_byte(uint32_t offset) {
+    return shadow ? shadow[offset] : read_byte(picture_start + offset);
 }
 
 void set_pix_yuv(uint16_t x, uint16_t y, uint8_t yuv) {
     uint32_t picline_byte_address = picture_start + picline_length_bytes * y;
-    write_byte(picline_byte_address + x, yuv);
+    if (picture_bits_per_pixel == 8) {
+        write_byte(picline_byte_address + x, yuv);
+        return;
+    }
+    // Packed pixels, the first one in the high bits
+    uint8_t pixels_per_byte = 8 / picture_bits_per_pixel;
+    uint8_t mask = (1 << picture_bits_per_pixel) - 1;
+    uint8_t shift = 8 - picture_bits_per_pixel * (x % pixels_per_byte + 1);
+    uint32_t offset = picline_length_bytes * y + x / pixels_per_byte;
+    uint8_t byte = (_picture_byte(offset) & ~(mask << shift)) | ((yuv & mask) << shift);
+    if (shadow) shadow[offset] = byte;
+    write_byte(picture_start + offset, byte);
+}
+
+void vs23_fill_span(uint16_t x, uint16_t y, uint16_t length, uint8_t yuv) {
+    if (y >= picture_height || x >= picture_width || length == 0) return;
+    if (length > picture_width - x) length = picture_width - x;
+    uint8_t pixels_per_byte = 8 / picture_bits_per_pixel;
+    uint8_t mask = (1 << picture_bits_per_pixel) - 1;
+    uint16_t end = x + length;
+    uint32_t first = x / pixels_per_byte;
+    uint32_t bytes = (end - 1) / pixels_per_byte - first + 1;
+    uint32_t offset = picline_length_bytes * y + first;
+
+    // Packed spans are built in the shadow and sent from there, without a
+    // shadow only partially covered edge bytes are read back.
+    if (!shadow && bytes > line_buffer_bytes) return;
+    uint8_t *target = shadow ? shadow + offset : line_buffer;
+    if (!shadow && x % pixels_per_byte) target[0] = _picture_byte(offset);
+    if (!shadow && end % pixels_per_byte) target[bytes - 1] = _picture_byte(offset + bytes - 1);
+
+    uint8_t full = 0;
+    for (uint8_t i = 0; i < pixels_per_byte; i++) full = (full << picture_bits_per_pixel) | (yuv & mask);
+    for (uint16_t i = x; i < end;) {
+        uint8_t *byte = &target[i / pixels_per_byte - first];
+        if (i % pixels_per_byte == 0 && end - i >= pixels_per_byte) {
+            uint16_t n = (end - i) / pixels_per_byte;
+            memset(byte, full, n);
+            i += n * pixels_per_byte;
+        } else {
+            uint8_t shift = 8 - picture_bits_per_pixel * (i % pixels_per_byte + 1);
+            *byte = (*byte & ~(mask << shift)) | ((yuv & mask) << shift);
+            i++;
+        }
+    }
+    write_buffer(picture_start + offset, target, bytes * 8);
+}
+
+esp_err_t vs23_read_rect_stream(uint16_t x, uint16_t y, uint16_t width, uint16_t height, vs23_line_callback_t callback, void *context) {
+    if (x >= picture_width || y >= picture_height || width == 0) return ESP_OK;
+    if (width > picture_width - x) width = picture_width - x;
+    if (height > picture_height - y) height = picture_height - y;
+    uint32_t first = x * picture_bits_per_pixel / 8;
+    uint32_t bytes = ((x + width) * picture_bits_per_pixel + 7) / 8 - first;
+    // As many lines per read as fit in one transaction, the gaps between
+    // them come along
+    size_t batch = get_max_transfer_size();
+    if (batch > VS23_READ_CHUNK_BYTES) batch = VS23_READ_CHUNK_BYTES;
+    uint16_t lines = batch / picline_length_bytes;
+    if (lines == 0) lines = 1;
+    size_t capacity = ((size_t)picline_length_bytes * lines + 3) & ~3;
+    uint8_t *buffer = heap_caps_malloc(capacity, MALLOC_CAP_DMA);
+    if (buffer == NULL) return ESP_ERR_NO_MEM;
+    acquire_spi_bus();
+    for (uint16_t i = 0; i < height; i += lines) {
+        uint16_t n = height - i < lines ? height - i : lines;
+        size_t length = (size_t)picline_length_bytes * (n - 1) + bytes;
+        read_buffer(picture_start + picline_length_bytes * (y + i) + first, buffer, ((length + 3) & ~3) * 8);
+        for (uint16_t j = 0; j < n; j++) {
+            callback(y + i + j, buffer + picline_length_bytes * j, bytes, context);
+        }
+    }
+    release_spi_bus();
+    heap_caps_free(buffer);
+    return ESP_OK;
+}
+
+void _copy_line(uint16_t y, const uint8_t *line, size_t length, void *context) {
+    uint8_t **out = context;
+    memcpy(*out, line, length);
+    *out += length;
+}
+
+esp_err_t vs23_read_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height, uint8_t *buffer) {
+    if (x == 0 && width == picture_width && y < picture_height) {
+        // Whole lines are contiguous, one queued transfer straight into buffer
+        if (height > picture_height - y) height = picture_height - y;
+        read_buffer(picture_start + picline_length_bytes * y, buffer, picline_length_bytes * height * 8);
+        return ESP_OK;
+    }
+    return vs23_read_rect_stream(x, y, width, height, _copy_line, &buffer);
+}
+
+void _crc_line(uint16_t y, const uint8_t *line, size_t length, void *context) {
+    uint32_t *crc = context;
+    *crc = esp_rom_crc32_le(*crc, line, length);
+}
+
+uint32_t vs23_crc32_rect(uint16_t x, uint16_t y, uint16_t width, uint16_t height) {
+    uint32_t crc = 0;
+    if (vs23_read_rect_stream(x, y, width, height, _crc_line, &crc) != ESP_OK) return 0;
+    return crc;
 }
 
 uint8_t rgb_to_yuv(uint8_t r, uint8_t g, uint8_t b) {
@@ -0,0 +1,235 @@
+#include <stdlib.h>
+
+#include "driver/spi_master.h"
+#include "esp_log.h"
+
+#include "vs23_spi.h"
+#include "vs23_driver.h"
+#include "vs23_raster.h"
+
+typedef struct {
+    int16_t y;
+    int16_t x0;
+    int16_t x1;
+} span_t;
+
+static span_t spans[VS23_RASTER_MAX_SPANS];
+static uint16_t span_count = 0;
+
+// Clip rectangle, end coordinates excluded. A zero width means the whole picture.
+static int16_t clip_x0 = 0, clip_y0 = 0, clip_x1 = 0, clip_y1 = 0;
+
+void vs23_raster_set_clip(int16_t x, int16_t y, uint16_t width, uint16_t height) {
+    clip_x0 = x;
+    clip_y0 = y;
+    clip_x1 = x + width;
+    clip_y1 = y + height;
+}
+
+void vs23_raster_reset_clip() {
+    clip_x0 = clip_y0 = clip_x1 = clip_y1 = 0;
+}
+
+void _clip_bounds(int16_t *x0, int16_t *y0, int16_t *x1, int16_t *y1) {
+    vs23_surface_t picture;
+    vs23_picture_surface(&picture);
+    *x0 = 0;
+    *y0 = 0;
+    *x1 = picture.width;
+    *y1 = picture.height;
+    if (clip_x1 > clip_x0) {
+        if (clip_x0 > *x0) *x0 = clip_x0;
+        if (clip_y0 > *y0) *y0 = clip_y0;
+        if (clip_x1 < *x1) *x1 = clip_x1;
+        if (clip_y1 < *y1) *y1 = clip_y1;
+    }
+}
+
+int _compare_spans(const void *a, const void *b) {
+    const span_t *sa = a, *sb = b;
+    if (sa->y != sb->y) return sa->y - sb->y;
+    return sa->x0 - sb->x0;
+}
+
+void _flush_spans(uint8_t yuv) {
+    if (span_count == 0) return;
+    int16_t x0, y0, x1, y1;
+    _clip_bounds(&x0, &y0, &x1, &y1);
+    qsort(spans, span_count, sizeof(span_t), _compare_spans);
+    acquire_spi_bus();
+    span_t run = spans[0];
+    for (uint16_t i = 1; i <= span_count; i++) {
+        // Overlapping or touching spans of a line make one run
+        if (i < span_count && spans[i].y == run.y && spans[i].x0 <= run.x1 + 1) {
+            if (spans[i].x1 > run.x1) run.x1 = spans[i].x1;
+            continue;
+        }
+        if (run.y >= y0 && run.y < y1) {
+            int16_t from = run.x0 < x0 ? x0 : run.x0;
+            int16_t to = run.x1 >= x1 ? x1 - 1 : run.x1;
+            if (from <= to) vs23_fill_span(from, run.y, to - from + 1, yuv);
+        }
+        if (i < span_count) run = spans[i];
+    }
+    release_spi_bus();
+    span_count = 0;
+}
+
+void _add_span(int16_t y, int16_t x0, int16_t x1, uint8_t yuv) {
+    if (x0 > x1) {
+        int16_t t = x0;
+        x0 = x1;
+        x1 = t;
+    }
+    if (span_count == VS23_RASTER_MAX_SPANS) _flush_spans(yuv);
+    spans[span_count].y = y;
+    spans[span_count].x0 = x0;
+    spans[span_count].x1 = x1;
+    span_count++;
+}
+
+void _line_spans(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t yuv) {
+    int16_t dx = abs(x1 - x0), sx = x0 < x1 ? 1 : -1;
+    int16_t dy = -abs(y1 - y0), sy = y0 < y1 ? 1 : -1;
+    int32_t err = dx + dy;
+    int16_t run_start = x0;
+    while (1) {
+        if (x0 == x1 && y0 == y1) break;
+        int32_t e2 = 2 * err;
+        if (e2 >= dy) {
+            err += dy;
+            x0 += sx;
+        }
+        if (e2 <= dx) {
+            // Leaving the row, the pixels so far are one span
+            _add_span(y0, run_start, x0 - (e2 >= dy ? sx : 0), yuv);
+            err += dx;
+            y0 += sy;
+            run_start = x0;
+        }
+    }
+    _add_span(y0, run_start, x0, yuv);
+}
+
+void vs23_draw_line(int16_t x0, int16_t y0, int16_t x1, int16_t y1, uint8_t yuv) {
+    _line_spans(x0, y0, x1, y1, yuv);
+    _flush_spans(yuv);
+}
+
+void vs23_draw_circle(int16_t cx, int16_t cy, uint16_t radius, uint8_t yuv) {
+    int16_t x = radius, y = 0;
+    int32_t err = 1 - (int32_t)radius;
+    while (x >= y) {
+        _add_span(cy + y, cx - x, cx - x, yuv);
+        _add_span(cy + y, cx + x, cx + x, yuv);
+        _add_span(cy - y, cx - x, cx - x, yuv);
+        _add_span(cy - y, cx + x, cx + x, yuv);
+        _add_span(cy + x, cx - y, cx - y, yuv);
+        _add_span(cy + x, cx + y, cx + y, yuv);
+        _add_span(cy - x, cx - y, cx - y, yuv);
+        _add_span(cy - x, cx + y, cx + y, yuv);
+        y++;
+        if (err < 0) {
+            err += 2 * y + 1;
+        } else {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+    _flush_spans(yuv);
+}
+
+void vs23_fill_circle(int16_t cx, int16_t cy, uint16_t radius, uint8_t yuv) {
+    int16_t x = radius, y = 0;
+    int32_t err = 1 - (int32_t)radius;
+    while (x >= y) {
+        _add_span(cy + y, cx - x, cx + x, yuv);
+        _add_span(cy - y, cx - x, cx + x, yuv);
+        _add_span(cy + x, cx - y, cx + y, yuv);
+        _add_span(cy - x, cx - y, cx + y, yuv);
+        y++;
+        if (err < 0) {
+            err += 2 * y + 1;
+        } else {
+            x--;
+            err += 2 * (y - x) + 1;
+        }
+    }
+    _flush_spans(yuv);
+}
+
+void vs23_fill_rect(int16_t x, int16_t y, uint16_t width, uint16_t height, uint8_t yuv) {
+    if (width == 0) return;
+    for (uint16_t i = 0; i < height; i++) _add_span(y + i, x, x + width - 1, yuv);
+    _flush_spans(yuv);
+}
+
+void vs23_draw_polygon(const vs23_point_t *points, uint16_t count, uint8_t yuv) {
+    for (uint16_t i = 0; i < count; i++) {
+        const vs23_point_t *a = &points[i], *b = &points[(i + 1) % count];
+        _line_spans(a->x, a->y, b->x, b->y, yuv);
+    }
+    _flush_spans(yuv);
+}
+
+void vs23_fill_polygon(const vs23_point_t *points, uint16_t count, uint8_t yuv) {
+    if (count < 3) return;
+    int16_t x0, y0, x1, y1;
+    _clip_bounds(&x0, &y0, &x1, &y1);
+    int16_t top = points[0].y, bottom = points[0].y;
+    for (uint16_t i = 1; i < count; i++) {
+        if (points[i].y < top) top = points[i].y;
+        if (points[i].y > bottom) bottom = points[i].y;
+    }
+    if (top < y0) top = y0;
+    if (bottom >= y1) bottom = y1 - 1;
+
+    int32_t crossings[VS23_RASTER_MAX_CROSSINGS];
+    bool overflow = false;
+    for (int16_t y = top; y <= bottom; y++) {
+        uint8_t n = 0;
+        bool complete = true;
+        for (uint16_t i = 0; i < count; i++) {
+            const vs23_point_t *a = &points[i], *b = &points[(i + 1) % count];
+            if (a->y == b->y) continue;
+            if (a->y > b->y) {
+                const vs23_point_t *t = a;
+                a = b;
+                b = t;
+            }
+            // Edges own their top row but not their bottom one
+            if (y < a->y || y >= b->y) continue;
+            // 16.16 fixed point crossing
+            // Multiplied rather than shifted, x may be negative
+            int32_t x = (int32_t)a->x * 65536 + (int32_t)((int64_t)(y - a->y) * (b->x - a->x) * 65536 / (b->y - a->y));
+            if (n == VS23_RASTER_MAX_CROSSINGS) {
+                complete = false;
+                break;
+            }
+            uint8_t j = n++;
+            while (j > 0 && crossings[j - 1] > x) {
+                crossings[j] = crossings[j - 1];
+                j--;
+            }
+            crossings[j] = x;
+        }
+        // A partial list pairs the wrong crossings, leave the line out
+        if (!complete) {
+            overflow = true;
+            continue;
+        }
+        // Even-odd rule: fill between crossing pairs
+        for (uint8_t i = 0; i + 1 < n; i += 2) {
+            int16_t from = (crossings[i] + 0xffff) >> 16;
+            int16_t to = ((crossings[i + 1] + 0xffff) >> 16) - 1;
+            if (from <= to) _add_span(y, from, to, yuv);
+        }
+    }
+    _flush_spans(yuv);
+    if (overflow) ESP_LOGW("VS23_RASTER", "Scanlines over %d edge crossings skipped", VS23_RASTER_MAX_CROSSINGS);
+}
+
+void vs23_fill_triangle(vs23_point_t a, vs23_point_t b, vs23_point_t c, uint8_t yuv) {
+    vs23_point_t points[] = {a, b, c};
+    vs23_fill_polygon(points, 3, yuv);
+}
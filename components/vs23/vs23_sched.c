@@ -0,0 +1,142 @@
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "driver/spi_master.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "vs23_spi.h"
+#include "vs23_driver.h"
+#include "vs23_sched.h"
+
+typedef struct {
+    uint32_t address;
+    const uint8_t *data;
+    size_t length;
+    size_t sent;
+    int64_t queued_us;
+    vs23_sched_done_t done;
+    void *context;
+} job_t;
+
+typedef struct {
+    job_t jobs[VS23_SCHED_QUEUE_DEPTH];
+    uint8_t head;
+    uint8_t count;
+    uint32_t completed;
+    uint32_t bytes;
+    uint64_t total_latency_us;
+    uint32_t max_latency_us;
+} queue_t;
+
+static queue_t queues[VS23_PRIORITY_COUNT];
+static uint32_t frame_budget = 0;
+// Guards head, count and the statistics, writers may be other tasks
+static portMUX_TYPE lock = portMUX_INITIALIZER_UNLOCKED;
+
+void vs23_sched_init(int clock_speed_hz) {
+    portENTER_CRITICAL(&lock);
+    memset(queues, 0, sizeof(queues));
+    portEXIT_CRITICAL(&lock);
+    vs23_sched_set_clock(clock_speed_hz);
+}
+
+void vs23_sched_set_clock(int clock_speed_hz) {
+    // Dual I/O writes move 2 bits per clock
+    uint64_t bytes_per_frame = (uint64_t)clock_speed_hz / 4 * VS23_FRAME_US / 1000000;
+    frame_budget = bytes_per_frame * VS23_SCHED_BUS_SHARE_PERCENT / 100;
+    ESP_LOGI("VS23_SCHED", "Frame budget %u bytes", (unsigned)frame_budget);
+}
+
+uint32_t vs23_sched_frame_budget() {
+    return frame_budget;
+}
+
+esp_err_t vs23_sched_write(vs23_priority_t priority, uint32_t address, const void *data, size_t length, vs23_sched_done_t done, void *context) {
+    if (priority >= VS23_PRIORITY_COUNT || length == 0) return ESP_ERR_INVALID_ARG;
+    queue_t *queue = &queues[priority];
+    int64_t now = esp_timer_get_time();
+    portENTER_CRITICAL(&lock);
+    if (queue->count == VS23_SCHED_QUEUE_DEPTH) {
+        portEXIT_CRITICAL(&lock);
+        return ESP_ERR_NO_MEM;
+    }
+    // The tail slot is not seen by the sender until count is raised
+    job_t *job = &queue->jobs[(queue->head + queue->count) % VS23_SCHED_QUEUE_DEPTH];
+    job->address = address;
+    job->data = data;
+    job->length = length;
+    job->sent = 0;
+    job->queued_us = now;
+    job->done = done;
+    job->context = context;
+    queue->count++;
+    portEXIT_CRITICAL(&lock);
+    return ESP_OK;
+}
+
+void _complete(queue_t *queue, job_t *job) {
+    uint32_t latency = esp_timer_get_time() - job->queued_us;
+    vs23_sched_done_t done = job->done;
+    void *context = job->context;
+    portENTER_CRITICAL(&lock);
+    queue->completed++;
+    queue->total_latency_us += latency;
+    if (latency > queue->max_latency_us) queue->max_latency_us = latency;
+    queue->head = (queue->head + 1) % VS23_SCHED_QUEUE_DEPTH;
+    queue->count--;
+    portEXIT_CRITICAL(&lock);
+    if (done) done(context);
+}
+
+void vs23_sched_run_frame() {
+    uint32_t budget = frame_budget;
+    acquire_spi_bus();
+    for (uint8_t priority = 0; priority < VS23_PRIORITY_COUNT; priority++) {
+        queue_t *queue = &queues[priority];
+        while (1) {
+            portENTER_CRITICAL(&lock);
+            job_t *job = queue->count > 0 ? &queue->jobs[queue->head] : NULL;
+            portEXIT_CRITICAL(&lock);
+            if (job == NULL) break;
+            size_t length = job->length - job->sent;
+            if (priority != VS23_PRIORITY_INTERACTIVE) {
+                // Others wait for the next frame once the budget is spent
+                if (budget == 0) break;
+                if (priority == VS23_PRIORITY_BULK && length > VS23_SCHED_SLICE_BYTES) length = VS23_SCHED_SLICE_BYTES;
+                if (length > budget) length = budget;
+            }
+            write_buffer(job->address + job->sent, (void *)(job->data + job->sent), length * 8);
+            job->sent += length;
+            portENTER_CRITICAL(&lock);
+            queue->bytes += length;
+            portEXIT_CRITICAL(&lock);
+            budget = length < budget ? budget - length : 0;
+            if (job->sent == job->length) _complete(queue, job);
+        }
+    }
+    release_spi_bus();
+}
+
+void vs23_sched_get_stats(vs23_priority_t priority, vs23_sched_stats_t *stats) {
+    queue_t *queue = &queues[priority];
+    portENTER_CRITICAL(&lock);
+    stats->completed = queue->completed;
+    stats->bytes = queue->bytes;
+    stats->pending = queue->count;
+    uint64_t total_latency_us = queue->total_latency_us;
+    stats->max_latency_us = queue->max_latency_us;
+    portEXIT_CRITICAL(&lock);
+    stats->average_latency_us = stats->completed ? total_latency_us / stats->completed : 0;
+}
+
+void vs23_sched_reset_stats() {
+    portENTER_CRITICAL(&lock);
+    for (uint8_t i = 0; i < VS23_PRIORITY_COUNT; i++) {
+        queues[i].completed = 0;
+        queues[i].bytes = 0;
+        queues[i].total_latency_us = 0;
+        queues[i].max_latency_us = 0;
+    }
+    portEXIT_CRITICAL(&lock);
+}
@@ -3,11 +3,17 @@
 
 #include "driver/gpio.h"
 #include "driver/spi_master.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 
 #include "vs23_spi.h"
 
 spi_device_handle_t spi;
+static uint8_t bus_acquired = 0;
+static size_t max_transfer_bytes = VS23_SPI_DEFAULT_MAX_TRANSFER_BYTES;
+static spi_transaction_t chunks[VS23_SPI_QUEUE_SIZE];
 
 void add_spi_device(spi_host_device_t host_id, int clock_speed_hz, int spics_io_num) {
     spi_device_interface_config_t devcfg = {
@@ -15,7 +21,7 @@ void add_spi_device(spi_host_device_t host_id, int clock_speed_hz, int spics_io_
         .flags = SPI_DEVICE_HALFDUPLEX | SPI_DEVICE_NO_DUMMY,
         .mode = 0,
         .spics_io_num = spics_io_num,
-        .queue_size = 1,
+        .queue_size = VS23_SPI_QUEUE_SIZE,
         .address_bits = 24,
         .command_bits = 8,
     };
@@ -23,13 +29,212 @@ void add_spi_device(spi_host_device_t host_id, int clock_speed_hz, int spics_io_
 }
 
 void remove_spi_device() {
+    flush_writes();
     spi_bus_remove_device(spi);
 }
 
+void set_max_transfer_size(size_t bytes) {
+  // Keep chunks 32bit aligned for the DMA
+  max_transfer_bytes = (bytes ? bytes : VS23_SPI_DEFAULT_MAX_TRANSFER_BYTES) & ~3;
+}
+
+size_t get_max_transfer_size() {
+  return max_transfer_bytes;
+}
+
+void acquire_spi_bus() {
+  if (bus_acquired++ == 0) {
+    ESP_ERROR_CHECK(spi_device_acquire_bus(spi, portMAX_DELAY));
+  }
+}
+
+void release_spi_bus() {
+  if (bus_acquired > 0 && --bus_acquired == 0) {
+    spi_device_release_bus(spi);
+  }
+}
+
+/*****************/
+/* Display lists */
+/*****************/
+static display_list_t *recording = NULL;
+static int64_t recording_start;
+
+void _record_transaction(display_list_t *list, const spi_transaction_t *transaction) {
+  if (list->count == list->capacity) {
+    uint16_t capacity = list->capacity ? list->capacity * 2 : 32;
+    spi_transaction_ext_t *transactions = NULL;
+    if (capacity > list->capacity) {
+      transactions = realloc(list->transactions, capacity * sizeof(spi_transaction_ext_t));
+    }
+    if (transactions == NULL) {
+      ESP_LOGE("VS23_SPI", "Display list out of memory");
+      list->failed = true;
+      return;
+    }
+    list->transactions = transactions;
+    list->capacity = capacity;
+  }
+  // Buffers are appended 32bit aligned to one DMA capable block
+  size_t bytes = (transaction->length + 7) / 8;
+  size_t offset = (list->data_length + 3) & ~3;
+  if (offset + bytes > list->data_capacity) {
+    size_t capacity = list->data_capacity ? list->data_capacity : 256;
+    while (offset + bytes > capacity) capacity *= 2;
+    uint8_t *data = heap_caps_realloc(list->data, capacity, MALLOC_CAP_DMA);
+    if (data == NULL) {
+      ESP_LOGE("VS23_SPI", "Display list out of memory");
+      list->failed = true;
+      return;
+    }
+    list->data = data;
+    list->data_capacity = capacity;
+  }
+  spi_transaction_ext_t *recorded = &list->transactions[list->count++];
+  memset(recorded, 0, sizeof(spi_transaction_ext_t));
+  if (transaction->flags & SPI_TRANS_VARIABLE_ADDR) {
+    // Register accesses are all built as extended transactions
+    *recorded = *(const spi_transaction_ext_t *)transaction;
+  } else {
+    recorded->base = *transaction;
+  }
+  if (bytes) memcpy(list->data + offset, transaction->tx_buffer, bytes);
+  // Resolved to a pointer once the data block stops moving
+  recorded->base.tx_buffer = (const void *)offset;
+  list->data_length = offset + bytes;
+}
+
+void _record(const spi_transaction_t *transaction) {
+  display_list_t *list = recording;
+  if (list->failed) return;
+  // Capturing is not part of drawing, it is accounted apart
+  int64_t start = esp_timer_get_time();
+  _record_transaction(list, transaction);
+  list->overhead_us += esp_timer_get_time() - start;
+}
+
+void begin_display_list(display_list_t *list) {
+  flush_writes();
+  memset(list, 0, sizeof(display_list_t));
+  recording = list;
+  recording_start = esp_timer_get_time();
+}
+
+void end_display_list() {
+  flush_writes();
+  display_list_t *list = recording;
+  recording = NULL;
+  if (list == NULL) return;
+  list->record_us = esp_timer_get_time() - recording_start;
+  list->direct_us = list->record_us - list->overhead_us;
+  if (list->failed) {
+    // Incomplete, drop what was captured but keep the failure visible
+    free(list->transactions);
+    heap_caps_free(list->data);
+    list->transactions = NULL;
+    list->data = NULL;
+    list->count = list->capacity = 0;
+    list->data_length = list->data_capacity = 0;
+    return;
+  }
+  for (uint16_t i = 0; i < list->count; i++) {
+    list->transactions[i].base.tx_buffer = list->data + (size_t)list->transactions[i].base.tx_buffer;
+  }
+}
+
+esp_err_t replay_display_list(display_list_t *list) {
+  if (list->failed || recording == list) return ESP_ERR_INVALID_STATE;
+  flush_writes();
+  int64_t start = esp_timer_get_time();
+  acquire_spi_bus();
+  uint16_t queued = 0;
+  int in_flight = 0;
+  // Prebuilt transactions, only queue them and collect the results
+  while (queued < list->count || in_flight > 0) {
+    if (queued < list->count && in_flight < VS23_SPI_QUEUE_SIZE) {
+      ESP_ERROR_CHECK(spi_device_queue_trans(spi, (spi_transaction_t *)&list->transactions[queued++], portMAX_DELAY));
+      in_flight++;
+    } else {
+      spi_transaction_t *done;
+      ESP_ERROR_CHECK(spi_device_get_trans_result(spi, &done, portMAX_DELAY));
+      in_flight--;
+    }
+  }
+  release_spi_bus();
+  list->replay_us = esp_timer_get_time() - start;
+  ESP_LOGI("VS23_SPI", "Display list %u ops %u bytes: direct %u us, replay %u us (recording overhead %u us)",
+           list->count, (unsigned)list->data_length, (unsigned)list->direct_us, (unsigned)list->replay_us,
+           (unsigned)list->overhead_us);
+  return ESP_OK;
+}
+
+void free_display_list(display_list_t *list) {
+  free(list->transactions);
+  heap_caps_free(list->data);
+  memset(list, 0, sizeof(display_list_t));
+}
+
+/*************/
+/* Transport */
+/*************/
+void _transmit_polling(spi_transaction_t *transaction) {
+  ESP_ERROR_CHECK(spi_device_polling_transmit(spi, transaction));
+}
+
+void _transmit_interrupt(spi_transaction_t *transaction) {
+  ESP_ERROR_CHECK(spi_device_transmit(spi, transaction));
+}
+
+void _transmit(spi_transaction_t *transaction) {
+  if (recording && transaction->rxlength == 0) _record(transaction);
+  // Small transactions are dominated by the interrupt and task switch
+  // overhead of spi_device_transmit, busy waiting is cheaper for those.
+  size_t bits = transaction->length > transaction->rxlength ? transaction->length : transaction->rxlength;
+  if (bits <= VS23_SPI_POLLING_MAX_BITS) {
+    _transmit_polling(transaction);
+  } else {
+    _transmit_interrupt(transaction);
+  }
+}
+
+void _transmit_chunked(const spi_transaction_t *base, uint32_t address, uint8_t *buffer, size_t length, bool read) {
+  size_t chunk_bits = max_transfer_bytes * 8;
+  size_t offset = 0;
+  int in_flight = 0;
+  int next = 0;
+  // Keep up to VS23_SPI_QUEUE_SIZE chunks queued so the driver starts the
+  // next one as soon as the previous completes. Results come back in order,
+  // so once the queue is full the oldest slot is the one to reuse.
+  while (offset < length || in_flight > 0) {
+    if (offset < length && in_flight < VS23_SPI_QUEUE_SIZE) {
+      size_t bits = length - offset < chunk_bits ? length - offset : chunk_bits;
+      spi_transaction_t *transaction = &chunks[next];
+      next = (next + 1) % VS23_SPI_QUEUE_SIZE;
+      *transaction = *base;
+      transaction->addr = (address + offset / 8) & 0x7ffff;
+      if (read) {
+        transaction->rxlength = bits;
+        transaction->rx_buffer = buffer + offset / 8;
+      } else {
+        transaction->length = bits;
+        transaction->tx_buffer = buffer + offset / 8;
+        if (recording) _record(transaction);
+      }
+      ESP_ERROR_CHECK(spi_device_queue_trans(spi, transaction, portMAX_DELAY));
+      in_flight++;
+      offset += bits;
+    } else {
+      spi_transaction_t *done;
+      ESP_ERROR_CHECK(spi_device_get_trans_result(spi, &done, portMAX_DELAY));
+      in_flight--;
+    }
+  }
+}
+
 /***************/
 /* SRAM Writes */
 /***************/
-void write_buffer(uint32_t address, void *tx_buffer, size_t length) {
+void _write_sram(uint32_t address, const void *tx_buffer, size_t length) {
   // SRAM Write are done in dual mode (address + data)
   // since quad modes fails on some patterns
   spi_transaction_t transaction = {
@@ -39,20 +244,74 @@ void write_buffer(uint32_t address, void *tx_buffer, size_t length) {
       .length = length,
       .tx_buffer = tx_buffer,
   };
-  ESP_ERROR_CHECK(spi_device_transmit(spi, &transaction));
+  if (length > max_transfer_bytes * 8) {
+    _transmit_chunked(&transaction, address, (uint8_t *)tx_buffer, length, false);
+  } else {
+    _transmit(&transaction);
+  }
+}
+
+/*******************/
+/* Write combining */
+/*******************/
+static bool write_combining = false;
+static WORD_ALIGNED_ATTR uint8_t combined[VS23_WRITE_COMBINING_BYTES];
+static uint32_t combined_address;
+static size_t combined_length = 0;
+
+bool set_write_combining(bool enabled) {
+  bool previous = write_combining;
+  if (!enabled) flush_writes();
+  write_combining = enabled;
+  return previous;
+}
+
+void flush_writes() {
+  if (combined_length == 0) return;
+  size_t length = combined_length;
+  combined_length = 0;
+  _write_sram(combined_address, combined, length * 8);
+}
+
+void _write_combined(uint32_t address, const void *data, size_t bytes) {
+  // A write inside or continuing the pending burst joins it, rewriting a
+  // pending byte in place (packed pixels sharing a byte)
+  if (combined_length > 0 && (address < combined_address || address > combined_address + combined_length)) flush_writes();
+  if (combined_length > 0 && address - combined_address + bytes > VS23_WRITE_COMBINING_BYTES) flush_writes();
+  if (combined_length == 0) combined_address = address;
+  size_t offset = address - combined_address;
+  memcpy(combined + offset, data, bytes);
+  if (offset + bytes > combined_length) combined_length = offset + bytes;
+}
+
+void write_buffer(uint32_t address, void *tx_buffer, size_t length) {
+  flush_writes();
+  _write_sram(address, tx_buffer, length);
 }
 
 void write_long(uint32_t address, uint32_t data) {
 	uint32_t swapped = SPI_SWAP_DATA_TX(data, 32);
+	if (write_combining) {
+		_write_combined(address * 4, &swapped, 4);
+		return;
+	}
 	write_buffer(address * 4, &swapped, 32);
 }
 
 void write_word(uint32_t address, uint16_t data) {
 	uint16_t swapped = SPI_SWAP_DATA_TX(data, 16);
+	if (write_combining) {
+		_write_combined(address * 2, &swapped, 2);
+		return;
+	}
 	write_buffer(address * 2, &swapped, 16);
 }
 
 void write_byte(uint32_t address, uint8_t data) {
+	if (write_combining) {
+		_write_combined(address, &data, 1);
+		return;
+	}
 	write_buffer(address, &data, 8);
 }
 
@@ -63,6 +322,7 @@ void read_buffer(uint32_t address, void *rx_buffer, size_t length) {
   // SRAM Read are done in:
   // - single mode for the address
   // - quad mode for the data
+  flush_writes();
   spi_transaction_t transaction = {
       .flags = SPI_TRANS_MODE_QIO,
       .cmd = 0X6B,
@@ -70,7 +330,11 @@ void read_buffer(uint32_t address, void *rx_buffer, size_t length) {
       .rxlength = length,
       .rx_buffer = rx_buffer,
   };
-  ESP_ERROR_CHECK(spi_device_transmit(spi, &transaction));
+  if (length > max_transfer_bytes * 8) {
+    _transmit_chunked(&transaction, address, rx_buffer, length, true);
+  } else {
+    _transmit(&transaction);
+  }
 }
 
 uint8_t read_byte(uint32_t address) {
@@ -104,7 +368,8 @@ uint8_t _read_8bit_register(uint8_t command) {
           },
       .address_bits = 0,
   };
-  ESP_ERROR_CHECK(spi_device_transmit(spi, (spi_transaction_t *)&transaction));
+  flush_writes();
+  _transmit((spi_transaction_t *)&transaction);
   return transaction.base.rx_data[0];
 }
 
@@ -120,7 +385,8 @@ uint16_t _read_16bit_register(uint8_t command) {
           },
       .address_bits = 0,
   };
-  ESP_ERROR_CHECK(spi_device_transmit(spi, (spi_transaction_t *)&transaction));
+  flush_writes();
+  _transmit((spi_transaction_t *)&transaction);
   return SPI_SWAP_DATA_RX(rx_data, 16);
 }
 
@@ -135,8 +401,9 @@ void _write_8bit_register(uint8_t command, uint8_t value) {
           },
       .address_bits = 0,
   };
-  ESP_LOGI("VS23_REG", "0x%02x <- 0x%02x", command, value);
-  ESP_ERROR_CHECK(spi_device_transmit(spi, (spi_transaction_t *)&transaction));
+  ESP_LOGV("VS23_REG", "0x%02x <- 0x%02x", command, value);
+  flush_writes();
+  _transmit((spi_transaction_t *)&transaction);
 }
 
 void _write_16bit_register(uint8_t command, uint16_t value) {
@@ -151,8 +418,9 @@ void _write_16bit_register(uint8_t command, uint16_t value) {
           },
       .address_bits = 0,
   };
-  ESP_LOGI("VS23_REG", "0x%02x <- 0x%04x", command, value);
-  ESP_ERROR_CHECK(spi_device_transmit(spi, (spi_transaction_t *)&transaction));
+  ESP_LOGV("VS23_REG", "0x%02x <- 0x%04x", command, value);
+  flush_writes();
+  _transmit((spi_transaction_t *)&transaction);
 }
 
 void _write_32bit_register(uint8_t command, uint32_t value) {
@@ -167,8 +435,22 @@ void _write_32bit_register(uint8_t command, uint32_t value) {
           },
       .address_bits = 0,
   };
-  ESP_LOGI("VS23_REG", "0x%02x <- 0x%08x", command, value);
-  ESP_ERROR_CHECK(spi_device_transmit(spi, (spi_transaction_t *)&transaction));
+  ESP_LOGV("VS23_REG", "0x%02x <- 0x%08x", command, value);
+  flush_writes();
+  _transmit((spi_transaction_t *)&transaction);
+}
+
+void _write_command(uint8_t command) {
+  spi_transaction_ext_t transaction = {
+      .base =
+          {
+              .flags = SPI_TRANS_VARIABLE_ADDR,
+              .cmd = command,
+          },
+      .address_bits = 0,
+  };
+  flush_writes();
+  _transmit((spi_transaction_t *)&transaction);
 }
 
 void _write_40bit_register(uint8_t command, uint16_t source, uint16_t target,  uint8_t value) {
@@ -183,8 +465,9 @@ void _write_40bit_register(uint8_t command, uint16_t source, uint16_t target,  u
           },
       .address_bits = 0,
   };
-  ESP_LOGI("VS23_REG", "0x%02x <- 0x%04x%04x%02x", command, source, target, value);
-  ESP_ERROR_CHECK(spi_device_transmit(spi, (spi_transaction_t *)&transaction));
+  ESP_LOGV("VS23_REG", "0x%02x <- 0x%04x%04x%02x", command, source, target, value);
+  flush_writes();
+  _transmit((spi_transaction_t *)&transaction);
 }
 
 /*************/
@@ -258,6 +541,12 @@ void write_block_move_control1(uint16_t source, uint16_t target, uint8_t flags)
   _write_40bit_register(0X34, source, target, flags);
 }
 
+void write_block_move_control2(uint16_t skip, uint16_t length, uint8_t lines) {
+  _write_40bit_register(0X35, skip, length, lines);
+}
+
+void start_block_move() { _write_command(0X36); }
+
 #ifdef SPI_TESTS
 // OK 32MHz, used to check other methods
 uint32_t read_safe(uint32_t address) {
@@ -401,4 +690,37 @@ void write_test_qqio(uint32_t address, uint32_t data) {
   };
   ESP_ERROR_CHECK(spi_device_transmit(spi, &transaction));
 };
+
+// Logs the polling vs interrupt latency of each transfer size class,
+// the SRAM content at address is overwritten.
+void spi_latency_benchmark(uint32_t address) {
+  static const size_t sizes[] = {1, 4, 16, 32, 64, 256, 1024};
+  const int rounds = 100;
+  uint8_t *buffer = heap_caps_malloc(1024, MALLOC_CAP_DMA);
+  memset(buffer, 0x55, 1024);
+  acquire_spi_bus();
+  ESP_LOGI("VS23_SPI", "bytes\tpolling us\tinterrupt us");
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    spi_transaction_t transaction = {
+        .flags = SPI_TRANS_MODE_DIO | SPI_TRANS_MULTILINE_ADDR,
+        .cmd = 0X22,
+        .addr = address & 0x7ffff,
+        .length = sizes[i] * 8,
+        .tx_buffer = buffer,
+    };
+    int64_t start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) _transmit_polling(&transaction);
+    int64_t polling = esp_timer_get_time() - start;
+    start = esp_timer_get_time();
+    for (int r = 0; r < rounds; r++) _transmit_interrupt(&transaction);
+    int64_t interrupt = esp_timer_get_time() - start;
+    // Averages in hundredths of microseconds
+    unsigned polling_avg = (unsigned)(polling * 100 / rounds);
+    unsigned interrupt_avg = (unsigned)(interrupt * 100 / rounds);
+    ESP_LOGI("VS23_SPI", "%u\t%u.%02u\t%u.%02u", (unsigned)sizes[i],
+             polling_avg / 100, polling_avg % 100, interrupt_avg / 100, interrupt_avg % 100);
+  }
+  release_spi_bus();
+  heap_caps_free(buffer);
+}
 #endif
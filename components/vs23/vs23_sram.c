@@ -0,0 +1,137 @@
+#include <string.h>
+
+#include "driver/spi_master.h"
+#include "esp_log.h"
+
+#include "vs23_spi.h"
+#include "vs23_driver.h"
+#include "vs23_sram.h"
+
+typedef struct {
+    uint32_t address;
+    uint32_t size;
+} region_t;
+
+// Used regions, sorted by address. Free memory is the gaps between them.
+static region_t regions[VS23_SRAM_MAX_REGIONS];
+static uint8_t region_count = 0;
+
+void vs23_sram_reset() {
+    region_count = 0;
+}
+
+esp_err_t _insert_region(uint8_t index, uint32_t address, uint32_t size) {
+    if (region_count == VS23_SRAM_MAX_REGIONS) {
+        ESP_LOGE("VS23_SRAM", "Out of region slots");
+        return ESP_ERR_NO_MEM;
+    }
+    memmove(&regions[index + 1], &regions[index], (region_count - index) * sizeof(region_t));
+    regions[index].address = address;
+    regions[index].size = size;
+    region_count++;
+    return ESP_OK;
+}
+
+esp_err_t vs23_sram_reserve(uint32_t address, uint32_t size) {
+    if (size == 0 || address + size > VS23_SRAM_BYTES) return ESP_ERR_INVALID_SIZE;
+    uint8_t i = 0;
+    while (i < region_count && regions[i].address < address) i++;
+    if (i > 0 && regions[i - 1].address + regions[i - 1].size > address) return ESP_ERR_INVALID_STATE;
+    if (i < region_count && address + size > regions[i].address) return ESP_ERR_INVALID_STATE;
+    return _insert_region(i, address, size);
+}
+
+esp_err_t vs23_sram_alloc(uint32_t size, uint32_t align, uint32_t *address) {
+    if (size == 0) return ESP_ERR_INVALID_SIZE;
+    if (align == 0) align = 1;
+    uint32_t gap_start = 0;
+    for (uint8_t i = 0; i <= region_count; i++) {
+        uint32_t gap_end = i < region_count ? regions[i].address : VS23_SRAM_BYTES;
+        uint32_t start = (gap_start + align - 1) & ~(align - 1);
+        if (start + size <= gap_end) {
+            *address = start;
+            return _insert_region(i, start, size);
+        }
+        if (i < region_count) gap_start = regions[i].address + regions[i].size;
+    }
+    return ESP_ERR_NO_MEM;
+}
+
+void vs23_sram_free(uint32_t address) {
+    for (uint8_t i = 0; i < region_count; i++) {
+        if (regions[i].address == address) {
+            memmove(&regions[i], &regions[i + 1], (region_count - i - 1) * sizeof(region_t));
+            region_count--;
+            return;
+        }
+    }
+    ESP_LOGW("VS23_SRAM", "Free of unknown region 0x%05x", (unsigned)address);
+}
+
+uint32_t vs23_sram_free_bytes() {
+    uint32_t used = 0;
+    for (uint8_t i = 0; i < region_count; i++) used += regions[i].size;
+    return VS23_SRAM_BYTES - used;
+}
+
+uint32_t vs23_sram_largest_free_block() {
+    uint32_t largest = 0;
+    uint32_t gap_start = 0;
+    for (uint8_t i = 0; i <= region_count; i++) {
+        uint32_t gap_end = i < region_count ? regions[i].address : VS23_SRAM_BYTES;
+        if (gap_end - gap_start > largest) largest = gap_end - gap_start;
+        if (i < region_count) gap_start = regions[i].address + regions[i].size;
+    }
+    return largest;
+}
+
+/************/
+/* Surfaces */
+/************/
+esp_err_t vs23_surface_alloc(vs23_surface_t *surface, uint16_t width, uint16_t height, uint8_t bits_per_pixel, uint16_t stride) {
+    uint16_t line_bytes = (width * bits_per_pixel + 7) / 8;
+    if (stride == 0) stride = line_bytes;
+    if (stride < line_bytes) return ESP_ERR_INVALID_SIZE;
+    esp_err_t err = vs23_sram_alloc((uint32_t)stride * height, VS23_SURFACE_ALIGN, &surface->address);
+    if (err != ESP_OK) return err;
+    surface->width = width;
+    surface->height = height;
+    surface->stride = stride;
+    surface->bits_per_pixel = bits_per_pixel;
+    return ESP_OK;
+}
+
+void vs23_surface_free(vs23_surface_t *surface) {
+    vs23_sram_free(surface->address);
+    surface->width = 0;
+    surface->height = 0;
+}
+
+uint32_t vs23_surface_address(const vs23_surface_t *surface, uint16_t x, uint16_t y) {
+    return surface->address + (uint32_t)surface->stride * y + x * surface->bits_per_pixel / 8;
+}
+
+void vs23_surface_write(const vs23_surface_t *surface, uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t *data) {
+    uint16_t line_bytes = (width * surface->bits_per_pixel + 7) / 8;
+    if (line_bytes == surface->stride) {
+        write_buffer(vs23_surface_address(surface, x, y), (void *)data, (size_t)line_bytes * height * 8);
+        return;
+    }
+    for (uint16_t i = 0; i < height; i++) {
+        write_buffer(vs23_surface_address(surface, x, y + i), (void *)(data + i * line_bytes), line_bytes * 8);
+    }
+}
+
+void vs23_surface_copy(const vs23_surface_t *source, uint16_t source_x, uint16_t source_y, const vs23_surface_t *target, uint16_t target_x, uint16_t target_y, uint16_t width, uint16_t height) {
+    uint16_t line_bytes = (width * source->bits_per_pixel + 7) / 8;
+    uint32_t from = vs23_surface_address(source, source_x, source_y);
+    uint32_t to = vs23_surface_address(target, target_x, target_y);
+    // A block move has a single skip for both sides, one move per line otherwise
+    if (source->stride == target->stride) {
+        vs23_block_move(from, to, line_bytes, height, source->stride);
+        return;
+    }
+    for (uint16_t i = 0; i < height; i++) {
+        vs23_block_move(from + (uint32_t)source->stride * i, to + (uint32_t)target->stride * i, line_bytes, 1, line_bytes);
+    }
+}
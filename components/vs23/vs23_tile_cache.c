@@ -0,0 +1,126 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "driver/spi_master.h"
+#include "esp_log.h"
+#include "esp_rom_crc.h"
+
+#include "vs23_spi.h"
+#include "vs23_driver.h"
+#include "vs23_tile_cache.h"
+
+typedef struct {
+    uint32_t hash;
+    uint32_t sum;
+    uint16_t width;
+    uint16_t height;
+    uint32_t last_used; // 0 for an empty slot
+} slot_t;
+
+static vs23_surface_t atlas = {0};
+static vs23_surface_t picture;
+static slot_t *slots = NULL;
+static uint16_t slot_count = 0;
+static uint16_t slots_per_row;
+static uint16_t slot_width;
+static uint16_t slot_height;
+static uint32_t tick = 0;
+static vs23_tile_cache_stats_t stats;
+
+esp_err_t vs23_tile_cache_init(uint16_t tile_width, uint16_t tile_height, uint16_t count) {
+    vs23_tile_cache_deinit();
+    vs23_picture_surface(&picture);
+    if (picture.bits_per_pixel != 8) return ESP_ERR_NOT_SUPPORTED;
+    if (tile_width == 0 || tile_height == 0 || tile_width > picture.stride) return ESP_ERR_INVALID_SIZE;
+    slot_width = tile_width;
+    slot_height = tile_height;
+    slots_per_row = picture.stride / tile_width;
+    // Shrink to the largest free block when the SRAM is short
+    uint16_t rows = (count + slots_per_row - 1) / slots_per_row;
+    uint32_t largest = vs23_sram_largest_free_block();
+    uint16_t fit = largest < VS23_SURFACE_ALIGN ? 0 : (largest - VS23_SURFACE_ALIGN) / ((uint32_t)picture.stride * tile_height);
+    if (rows > fit) rows = fit;
+    if (rows == 0) return ESP_ERR_NO_MEM;
+    if (count > rows * slots_per_row) count = rows * slots_per_row;
+    esp_err_t err = vs23_surface_alloc(&atlas, slots_per_row * tile_width, rows * tile_height, 8, picture.stride);
+    if (err != ESP_OK) return err;
+    slots = calloc(count, sizeof(slot_t));
+    if (slots == NULL) {
+        vs23_surface_free(&atlas);
+        return ESP_ERR_NO_MEM;
+    }
+    slot_count = count;
+    ESP_LOGI("VS23_TILES", "%u slots of %ux%u", slot_count, slot_width, slot_height);
+    return ESP_OK;
+}
+
+void vs23_tile_cache_deinit() {
+    if (slots == NULL) return;
+    vs23_block_move_wait();
+    vs23_surface_free(&atlas);
+    free(slots);
+    slots = NULL;
+    slot_count = 0;
+}
+
+// Fletcher style running sum, a second key independent of the CRC so that
+// a CRC collision alone does not draw the wrong tile
+uint32_t _checksum(const uint8_t *pixels, uint32_t length) {
+    uint16_t a = 0, b = 0;
+    for (uint32_t i = 0; i < length; i++) {
+        a += pixels[i];
+        b += a;
+    }
+    return (uint32_t)b << 16 | a;
+}
+
+uint32_t _slot_address(uint16_t slot) {
+    return vs23_surface_address(&atlas, (slot % slots_per_row) * slot_width, (slot / slots_per_row) * slot_height);
+}
+
+void vs23_draw_tile(uint16_t x, uint16_t y, uint16_t width, uint16_t height, const uint8_t *pixels) {
+    vs23_picture_surface(&picture);
+    if (picture.bits_per_pixel != 8 || x + width > picture.width || y + height > picture.height) return;
+    // A block move skips the same stride in the atlas and the picture, the
+    // cache waits for a picture with the stride it was laid out for
+    if (slots == NULL || picture.stride != atlas.stride || width > slot_width || height > slot_height) {
+        vs23_surface_write(&picture, x, y, width, height, pixels);
+        return;
+    }
+    uint32_t hash = esp_rom_crc32_le(width | (uint32_t)height << 16, pixels, (uint32_t)width * height);
+    uint32_t sum = _checksum(pixels, (uint32_t)width * height);
+    uint16_t victim = 0;
+    for (uint16_t i = 0; i < slot_count; i++) {
+        slot_t *slot = &slots[i];
+        if (slot->last_used && slot->hash == hash && slot->sum == sum && slot->width == width && slot->height == height) {
+            slot->last_used = ++tick;
+            stats.hits++;
+            stats.bytes_saved += (uint32_t)width * height;
+            vs23_block_move(_slot_address(i), vs23_surface_address(&picture, x, y), width, height, picture.stride);
+            return;
+        }
+        if (slot->last_used < slots[victim].last_used) victim = i;
+    }
+
+    stats.misses++;
+    if (slots[victim].last_used) stats.evictions++;
+    // The slot may still be the source of a running move
+    vs23_block_move_wait();
+    uint16_t column = (victim % slots_per_row) * slot_width;
+    uint16_t row = (victim / slots_per_row) * slot_height;
+    vs23_surface_write(&atlas, column, row, width, height, pixels);
+    slots[victim].hash = hash;
+    slots[victim].sum = sum;
+    slots[victim].width = width;
+    slots[victim].height = height;
+    slots[victim].last_used = ++tick;
+    vs23_block_move(_slot_address(victim), vs23_surface_address(&picture, x, y), width, height, picture.stride);
+}
+
+void vs23_tile_cache_get_stats(vs23_tile_cache_stats_t *out) {
+    *out = stats;
+}
+
+void vs23_tile_cache_reset_stats() {
+    memset(&stats, 0, sizeof(stats));
+}